@@ -0,0 +1,519 @@
+#include <stdlib.h>
+#include "engine.h"
+
+
+const Rules DEFAULT_RULES = {
+    {2, 2, 2, 2, 2, 2, 1, 1, 1, 0, 0},
+    {3, 2, 1, 0, 0, 0, 2, 1, 1, 2, 1},
+    10,
+    5,
+};
+
+// Arena allocations are aligned for any particle or pointer
+const size_t ARENA_ALIGNMENT = 16;
+
+static size_t aligned(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+void new_arena(Arena* arena, size_t size) {
+    arena->memory = malloc(size);
+    arena->size = arena->memory != NULL ? size : 0;
+    arena->used = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+
+    size = aligned(size);
+    if (size > arena->size - arena->used) return NULL;
+
+    void* memory = arena->memory + arena->used;
+    arena->used += size;
+
+    return memory;
+}
+
+void arena_reset(Arena* arena) {
+    arena->used = 0;
+}
+
+void free_arena(Arena* arena) {
+    free(arena->memory);
+    arena->memory = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+void random_seed(World* world, uint32_t seed) {
+    world->random_state = seed != 0 ? seed : 1;  // Xorshift gets stuck on 0
+}
+
+int random_next(World* world) {
+    world->random_state ^= world->random_state << 13;
+    world->random_state ^= world->random_state >> 17;
+    world->random_state ^= world->random_state << 5;
+
+    return (int)(world->random_state >> 1);
+}
+
+// Creates a particle
+void new_particle(World* world, Particle* p, int type, int element) {
+    p->type = type;
+    p->element = element;
+    p->velocity = random_next(world) % 2 == 0 ? -1 : 1;
+    p->gravity = 1.0;
+    p->updated = false;
+}
+
+void mix_elements(World* world, int x1, int y1, int x2, int y2) {
+
+    Particle* p = world->map[x1][y1];
+    world->map[x1][y1] = world->map[x2][y2];
+    world->map[x2][y2] = p;
+
+    world->moves++;
+}
+
+// Turns a particle into another element
+void change_element(World* world, Particle* p, int element, int type) {
+
+    p->element = element;
+    p->type = type;
+
+    world->reactions++;
+}
+
+bool float_up(Particle* p, World* world, int x, int y) {
+
+    int gravity = (int)p->gravity;
+    int yn = y;
+
+    for (int g=1; g<=gravity; g++) {
+
+        if (y-g >= 0 && world->map[x][y-g]->type < p->type) yn = y-g;
+        else break;
+    }
+
+    if (y == yn) {
+        p->gravity = 1.0;
+
+        return false;
+    }
+    else {
+        mix_elements(world, x, y, x, yn);
+        
+        p->gravity += 0.1 * (y-yn);
+
+        return true;
+    }
+}
+
+bool fall_down(Particle* p, World* world, int x, int y) {
+
+    int gravity = (int)p->gravity;
+    int yn = y;
+
+    for (int g=1; g<=gravity; g++) {
+
+        if (y+g < world->height && world->map[x][y+g]->type < p->type) yn = y+g;
+        else break;
+    }
+
+    if (y == yn) {
+        p->gravity = 1.0;
+
+        return false;
+    }
+    else {
+        mix_elements(world, x, y, x, yn);
+        
+        p->gravity += 0.1 * (yn-y);
+
+        return true;
+    }
+}
+
+bool move_left(Particle* p, World* world, int x, int y, int h) {
+
+    int distance = world->rules.spread[p->element];
+    for (int d=0; d < distance; d++) {
+
+        if (x-d > 0) {
+
+            int xn = x-1-d;
+            int yn = y+h;
+
+            if (world->map[xn][y]->type - distance + d + 2 < p->type) {
+                if (world->map[xn][yn]->type < p->type) {
+                    
+                    mix_elements(world, x, y, xn, yn);
+                    
+                    return true;
+                }
+            }
+            else break;
+        }
+    }
+    return false;
+}
+
+bool move_right(Particle* p, World* world, int x, int y, int h) {
+
+    int distance = world->rules.spread[p->element];
+    for (int d=0; d < distance; d++) {
+
+        if (x+d < world->width-1) {
+
+            int xn = x+1+d;
+            int yn = y+h;
+
+            if (world->map[xn][y]->type - distance + d + 2 < p->type) {
+                if (world->map[xn][yn]->type < p->type) {
+
+                    mix_elements(world, x, y, xn, yn);
+
+                    return true;
+                }
+            }
+            else break;
+        }
+    }
+    return false;
+}
+
+bool move_side(Particle* p, World* world, int x, int y, int h) {
+
+    if ((y < world->height-1 && h == 1) || (y > 0 && h == -1)) {
+        int fall = random_next(world) % 2;
+
+        if (fall == 0) {
+            if (move_left(p, world, x, y, h)) return true;
+            if (move_right(p, world, x, y, h)) return true;
+        }
+        else {
+            if (move_right(p, world, x, y, h)) return true;
+            if (move_left(p, world, x, y, h)) return true;
+        }
+    }
+    return false;
+}
+
+bool flow(Particle* p, World* world, int x, int y) {
+
+    int xn; 
+    if (p->velocity == 1) {
+
+        xn = x;
+        for (int n=1; n<world->rules.spread[p->element]+1; n++) {
+
+            if (x-n >= 0 && world->map[x-n][y]->type < p->type) xn = x-n;
+            else break;
+        }
+    }
+    if (p->velocity == -1) {
+
+        xn = x;
+        for (int n=1; n<world->rules.spread[p->element]+1; n++) {
+
+            if (x+n < world->width && world->map[x+n][y]->type < p->type) xn = x+n;
+            else break;
+        }
+    }
+    if (xn == x) {
+        p->velocity *= -1;
+        return false;
+    }
+    else {
+        mix_elements(world, x, y, xn, y);
+        return true;
+    }
+}
+
+void sand_update(Particle* p, World* world, int x, int y) {
+
+    if (!fall_down(p, world, x, y)) {
+
+        move_side(p, world, x, y, 1);
+    }
+}
+
+void dirt_update(Particle* p, World* world, int x, int y) {
+
+    if (!fall_down(p, world, x, y)) {
+
+        move_side(p, world, x, y, 1);
+    }
+}
+
+void stone_update(Particle* p, World* world, int x, int y) {
+
+    if (!fall_down(p, world, x, y)) {
+
+        move_side(p, world, x, y, 1);
+    }
+}
+
+void obsidian_update(Particle* p, World* world, int x, int y) {
+    fall_down(p, world, x, y);
+}
+
+void steel_update(Particle* p, World* world, int x, int y) {}
+
+void wood_update(Particle* p, World* world, int x, int y) {}
+
+void water_update(Particle* p, World* world, int x, int y) {
+
+    bool end = false;
+
+    if (x > 0) {
+        if (world->map[x-1][y]->element == PARTICLE_ACID) {
+            change_element(world, world->map[x-1][y], PARTICLE_NONE, PARTICLE_VOID);
+            end = true;
+        }
+    }
+    if (x < world->width-1) {
+        if (world->map[x+1][y]->element == PARTICLE_ACID) {
+            change_element(world, world->map[x+1][y], PARTICLE_NONE, PARTICLE_VOID);
+            end = true;
+        }
+    }
+    if (y < world->height-1) {
+        if (world->map[x][y+1]->element == PARTICLE_LAVA) {
+            change_element(world, world->map[x][y+1], PARTICLE_OBSIDIAN, world->rules.types[PARTICLE_OBSIDIAN]);
+            end = true;
+        }
+        else if (world->map[x][y+1]->element == PARTICLE_ACID) {
+            change_element(world, world->map[x][y+1], PARTICLE_NONE, PARTICLE_VOID);
+            end = true;
+        }
+    }
+    if (end) {
+        change_element(world, p, PARTICLE_STEAM, world->rules.types[PARTICLE_STEAM]);
+        return;
+    }
+
+    if (fall_down(p, world, x, y)) return;
+    if (flow(p, world, x, y)) return;
+}
+
+void lava_update(Particle* p, World* world, int x, int y) {
+
+    bool end = false;
+
+    if (x > 0) {
+        if (world->map[x-1][y]->element == PARTICLE_WATER || world->map[x-1][y]->element == PARTICLE_ACID) {
+            change_element(world, world->map[x-1][y], PARTICLE_STEAM, world->rules.types[PARTICLE_STEAM]);
+            end = true;
+        }
+        else if (world->map[x-1][y]->element == PARTICLE_WOOD) {
+            change_element(world, world->map[x-1][y], PARTICLE_SMOKE, world->rules.types[PARTICLE_SMOKE]);
+            if (random_next(world) % world->rules.lava_burn == 0) end = true;
+        }
+    }
+    if (x < world->width-1) {
+        if (world->map[x+1][y]->element == PARTICLE_WATER || world->map[x+1][y]->element == PARTICLE_ACID) {
+            change_element(world, world->map[x+1][y], PARTICLE_STEAM, world->rules.types[PARTICLE_STEAM]);
+            end = true;
+        }
+        else if (world->map[x+1][y]->element == PARTICLE_WOOD) {
+            change_element(world, world->map[x+1][y], PARTICLE_SMOKE, world->rules.types[PARTICLE_SMOKE]);
+            if (random_next(world) % world->rules.lava_burn == 0) end = true;
+        }
+    }
+    if (y < world->height-1) {
+        if (world->map[x][y+1]->element == PARTICLE_WATER || world->map[x][y+1]->element == PARTICLE_ACID) {
+            change_element(world, world->map[x][y+1], PARTICLE_STEAM, world->rules.types[PARTICLE_STEAM]);
+            end = true;
+        }
+        else if (world->map[x][y+1]->element == PARTICLE_WOOD) {
+            change_element(world, world->map[x][y+1], PARTICLE_SMOKE, world->rules.types[PARTICLE_SMOKE]);
+            if (random_next(world) % world->rules.lava_burn == 0) end = true;
+        }
+    }
+    if (end) {
+        change_element(world, p, PARTICLE_STONE, world->rules.types[PARTICLE_STONE]);
+        return;
+    }
+
+    if (fall_down(p, world, x, y)) return;
+    if (move_side(p, world, x, y, 1)) return;
+    if (flow(p, world, x, y)) return;
+
+
+}
+
+void acid_update(Particle* p, World* world, int x, int y) {
+
+    bool end = false;
+
+    if (y < world->height-1) {
+        if (world->map[x][y+1]->element == PARTICLE_WATER) {
+            change_element(world, world->map[x][y+1], PARTICLE_NONE, PARTICLE_VOID);
+            end = true;
+        }
+        else if (world->map[x][y+1]->element == PARTICLE_LAVA) {
+            change_element(world, world->map[x][y+1], PARTICLE_OBSIDIAN, world->rules.types[PARTICLE_OBSIDIAN]);
+            end = true;
+        }
+        else if (world->map[x][y+1]->element == PARTICLE_WOOD) {
+            change_element(world, world->map[x][y+1], PARTICLE_NONE, PARTICLE_VOID);
+            if (random_next(world) % world->rules.acid_burn == 0) end = true;
+        }
+    }
+    if (end) {
+        change_element(world, p, PARTICLE_STEAM, world->rules.types[PARTICLE_STEAM]);
+        return;
+    }
+
+    if (fall_down(p, world, x, y)) return;
+    if (flow(p, world, x, y)) return;
+}
+
+void steam_update(Particle* p, World* world, int x, int y) {
+
+    if (float_up(p, world, x, y)) return;
+    if (flow(p, world, x, y)) return;
+}
+
+void smoke_update(Particle* p, World* world, int x, int y) {
+
+    if (float_up(p, world, x, y)) return;
+    if (move_side(p, world, x, y, -1)) return;
+    if (flow(p, world, x, y)) return;
+}
+
+
+// Different update functions for different types
+static const function particle_update_functions[length] = {sand_update, dirt_update, stone_update, obsidian_update, steel_update, wood_update, water_update, lava_update, acid_update, steam_update, smoke_update};
+
+size_t world_size(int width, int height) {
+
+    if (width < 1 || height < 1) return 0;
+
+    // Every part stays below a quarter of SIZE_MAX, so neither the rounding nor the sum can wrap
+    size_t limit = SIZE_MAX / 4;
+    if ((size_t)width > limit / sizeof(Particle) / (size_t)height) return 0;
+
+    size_t cells = (size_t)width * height;
+
+    return aligned(sizeof(World)) + aligned(sizeof(Particle**) * width) +
+           aligned(sizeof(Particle*) * cells) + aligned(sizeof(Particle) * cells);
+}
+
+World* new_world(Arena* arena, int width, int height) {
+
+    size_t size = world_size(width, height);
+    if (size == 0 || arena->size - arena->used < size) return NULL;
+
+    size_t cells = (size_t)width * height;
+
+    World* world = arena_alloc(arena, sizeof(World));
+    world->width = width;
+    world->height = height;
+    world->rules = DEFAULT_RULES;
+    world->moves = 0;
+    world->reactions = 0;
+    world->map = arena_alloc(arena, sizeof(Particle**) * width);
+    world->cells = arena_alloc(arena, sizeof(Particle*) * cells);
+    world->particles = arena_alloc(arena, sizeof(Particle) * cells);
+
+    random_seed(world, 1);
+    clear_world(world);
+
+    return world;
+}
+
+void clear_world(World* world) {
+
+    // Puts every particle back in its own cell, columns stay contiguous in memory
+    for (int w=0; w < world->width; w++) {
+
+        world->map[w] = world->cells + (size_t)w * world->height;
+
+        for (int h=0; h < world->height; h++) {
+            world->map[w][h] = world->particles + (size_t)w * world->height + h;
+            new_particle(world, world->map[w][h], PARTICLE_VOID, PARTICLE_NONE);
+        }
+    }
+}
+
+void seed_world(World* world, uint32_t seed) {
+
+    random_seed(world, seed);
+    clear_world(world);
+
+    // Drops blobs the same way the brush draws them
+    int blobs = 20 + random_next(world) % 20;
+    for (int blob=0; blob < blobs; blob++) {
+
+        int element = random_next(world) % length;
+        int size = random_next(world) % 6;
+        int x = random_next(world) % world->width;
+        int y = random_next(world) % world->height;
+
+        for (int i = -1*size; i <= size; i++) {
+            for (int j = -1*size; j <= size; j++) {
+
+                int xi = x+i;
+                int yj = y+j;
+                if (xi < 0 || xi >= world->width || yj < 0 || yj >= world->height) continue;
+                if (world->map[xi][yj]->type == PARTICLE_VOID) {
+                    new_particle(world, world->map[xi][yj], world->rules.types[element], element);
+                }
+            }
+        }
+    }
+}
+
+void update_world(World* world) {
+
+    world->moves = 0;
+    world->reactions = 0;
+
+    for (int w=0; w < world->width; w++) {
+        for (int h=0; h < world->height; h++) {
+
+            Particle* p = world->map[w][h];
+
+            if (p->type == PARTICLE_VOID || p->updated) continue;
+
+            p->updated = true;
+            particle_update_functions[p->element](p, world, w, h);
+        }
+    }
+
+    // Particles can move into cells that are visited later, so flags are cleared after the whole pass
+    for (int w=0; w < world->width; w++) {
+        for (int h=0; h < world->height; h++) {
+            world->map[w][h]->updated = false;
+        }
+    }
+}
+
+// Mixes a value into a FNV-1a hash
+static uint64_t hash_int(uint64_t hash, int value) {
+
+    uint32_t v = (uint32_t)value;
+    for (int byte=0; byte < 4; byte++) {
+        hash ^= (v >> (8 * byte)) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t hash_world(World* world) {
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (int w=0; w < world->width; w++) {
+        for (int h=0; h < world->height; h++) {
+
+            Particle* p = world->map[w][h];
+
+            hash = hash_int(hash, p->type);
+            hash = hash_int(hash, p->element);
+            hash = hash_int(hash, p->velocity);
+            hash = hash_int(hash, (int)(p->gravity * 10));
+        }
+    }
+    return hash;
+}
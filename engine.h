@@ -0,0 +1,119 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define length 11
+
+
+// Particle constants
+static const int PARTICLE_VOID = -1;
+static const int PARTICLE_GAS = 0;
+static const int PARTICLE_LIQUID = 1;
+static const int PARTICLE_SOLID = 2;
+
+static const int PARTICLE_NONE = -1;
+static const int PARTICLE_SAND = 0;
+static const int PARTICLE_DIRT = 1;
+static const int PARTICLE_STONE = 2;
+static const int PARTICLE_OBSIDIAN = 3;
+static const int PARTICLE_STEEL = 4;
+static const int PARTICLE_WOOD = 5;
+static const int PARTICLE_WATER = 6;
+static const int PARTICLE_LAVA = 7;
+static const int PARTICLE_ACID = 8;
+static const int PARTICLE_STEAM = 9;
+static const int PARTICLE_SMOKE= 10;
+
+// Pre-define Structures
+typedef struct Particle Particle;
+typedef struct World World;
+
+// Function variables type
+typedef void (*function)(Particle*, World*, int, int);
+
+// Engine variables type, advances the whole world by one tick
+typedef void (*step_function)(World*);
+
+// Custum particle struct
+struct Particle {
+    int type;
+    int element;
+    int velocity;
+    float gravity;
+    bool updated;
+};
+
+// Rules struct, element constants that can differ between worlds
+typedef struct {
+    int types[length];
+    int spread[length];
+    int lava_burn;  // Lava burning wood turns to stone with a 1 in lava_burn chance
+    int acid_burn;  // Acid eating wood turns to steam with a 1 in acid_burn chance
+} Rules;
+
+extern const Rules DEFAULT_RULES;
+
+// World struct, a map with its own random generator so worlds can be updated side by side
+struct World {
+    int width;
+    int height;
+    uint32_t random_state;
+    Rules rules;
+    int moves;      // Particles swapped by the last update_world
+    int reactions;  // Particles that changed element in the last update_world
+    Particle*** map;
+    Particle** cells;
+    Particle* particles;
+};
+
+// Arena struct, one block of memory handed out front to back and released all at once
+typedef struct {
+    char* memory;
+    size_t size;
+    size_t used;
+} Arena;
+
+// Allocates the arena block, size is 0 if it failed
+void new_arena(Arena* arena, size_t size);
+
+// Returns the next aligned piece of the arena or NULL when it is full
+void* arena_alloc(Arena* arena, size_t size);
+
+// Releases everything allocated from the arena
+void arena_reset(Arena* arena);
+
+// Deallocates the arena block
+void free_arena(Arena* arena);
+
+// Seeds the world random generator, same seed gives the same simulation
+void random_seed(World* world, uint32_t seed);
+
+// Returns a non negative random number
+int random_next(World* world);
+
+// Creates a particle
+void new_particle(World* world, Particle* p, int type, int element);
+
+// Arena bytes needed by new_world, 0 if the size is not positive or too big to address
+size_t world_size(int width, int height);
+
+// Allocates a world with the default rules filled with void particles, NULL if the size is invalid or the arena is too small
+World* new_world(Arena* arena, int width, int height);
+
+// Fills the world with void particles
+void clear_world(World* world);
+
+// Fills the world with random blobs of elements, reseeds the random generator
+void seed_world(World* world, uint32_t seed);
+
+// Updates every particle once, reference scalar engine
+void update_world(World* world);
+
+// Hashes the state of every cell in the world
+uint64_t hash_world(World* world);
+
+#endif
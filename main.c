@@ -3,11 +3,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
-
-
-#define width (SCREEN_WIDTH / PARTICLE_SIZE)
-#define height (SCREEN_HEIGHT / PARTICLE_SIZE)
-#define length 11
+#include "engine.h"
 
 
 // Window constants
@@ -20,371 +16,7 @@ const int FPS = 100;
 const int PARTICLE_SIZE = 5;
 const int PARTICLE_UPDATE_DELAY = 1;
 
-const int PARTICLE_VOID = -1;
-const int PARTICLE_GAS = 0;
-const int PARTICLE_LIQUID = 1;
-const int PARTICLE_SOLID = 2;
-
-const int PARTICLE_NONE = -1;
-const int PARTICLE_SAND = 0;
-const int PARTICLE_DIRT = 1;
-const int PARTICLE_STONE = 2;
-const int PARTICLE_OBSIDIAN = 3;
-const int PARTICLE_STEEL = 4;
-const int PARTICLE_WOOD = 5;
-const int PARTICLE_WATER = 6;
-const int PARTICLE_LAVA = 7;
-const int PARTICLE_ACID = 8;
-const int PARTICLE_STEAM = 9;
-const int PARTICLE_SMOKE= 10;
 const int COLORS[length][3] = {{230, 120, 0}, {150, 90, 30}, {70, 75, 70}, {20, 15, 15}, {100, 115, 115}, {120, 60, 0}, {35,137,218}, {255, 42, 0}, {34, 204, 0}, {200, 200, 210}, {10, 5, 5}};
-const int TYPES[length] = {2, 2, 2, 2, 2, 2, 1, 1, 1, 0, 0};
-const int SPREAD[length] = {3, 2, 1, 0, 0, 0, 2, 1, 1, 2, 1};
-
-// Pre-define Structure
-typedef struct Particle Particle;
-
-// Function variables type
-typedef void (*function)(Particle*, Particle***, int, int);
-
-// Custum particle struct
-struct Particle {
-    int type;
-    int element;
-    int velocity;
-    float gravity;
-    bool updated;
-};
-// Creates a particle
-void new_particle(Particle* p, int type, int element) {
-    p->type = type;
-    p->element = 1;
-    p->velocity = rand() % 2 == 0 ? -1 : 1;
-    p->gravity = 1.0;
-    p->updated = false;
-}
-
-void mix_elements(Particle*** map, int x1, int y1, int x2, int y2) {
-
-    Particle* p = map[x1][y1];
-    map[x1][y1] = map[x2][y2];
-    map[x2][y2] = p;
-}
-
-bool float_up(Particle* p, Particle*** map, int x, int y) {
-
-    int gravity = (int)p->gravity;
-    int yn = y;
-
-    for (int g=1; g<=gravity; g++) {
-
-        if (y-g >= 0 && map[x][y-g]->type < p->type) yn = y-g;
-        else break;
-    }
-
-    if (y == yn) {
-        p->gravity = 1.0;
-
-        return false;
-    }
-    else {
-        mix_elements(map, x, y, x, yn);
-        
-        p->gravity += 0.1 * (y-yn);
-
-        return true;
-    }
-}
-
-bool fall_down(Particle* p, Particle*** map, int x, int y) {
-
-    int gravity = (int)p->gravity;
-    int yn = y;
-
-    for (int g=1; g<=gravity; g++) {
-
-        if (y+g < height && map[x][y+g]->type < p->type) yn = y+g;
-        else break;
-    }
-
-    if (y == yn) {
-        p->gravity = 1.0;
-
-        return false;
-    }
-    else {
-        mix_elements(map, x, y, x, yn);
-        
-        p->gravity += 0.1 * (yn-y);
-
-        return true;
-    }
-}
-
-bool move_left(Particle* p, Particle*** map, int x, int y, int h) {
-
-    int distance = SPREAD[p->element];
-    for (int d=0; d < distance; d++) {
-
-        if (x-d > 0) {
-
-            int xn = x-1-d;
-            int yn = y+h;
-
-            if (map[xn][y]->type - distance + d + 2 < p->type) {
-                if (map[xn][yn]->type < p->type) {
-                    
-                    mix_elements(map, x, y, xn, yn);
-                    
-                    return true;
-                }
-            }
-            else break;
-        }
-    }
-    return false;
-}
-
-bool move_right(Particle* p, Particle*** map, int x, int y, int h) {
-
-    int distance = SPREAD[p->element];
-    for (int d=0; d < distance; d++) {
-
-        if (x+d < width-1) {
-
-            int xn = x+1+d;
-            int yn = y+h;
-
-            if (map[xn][y]->type - distance + d + 2 < p->type) {
-                if (map[xn][yn]->type < p->type) {
-
-                    mix_elements(map, x, y, xn, yn);
-
-                    return true;
-                }
-            }
-            else break;
-        }
-    }
-    return false;
-}
-
-bool move_side(Particle* p, Particle*** map, int x, int y, int h) {
-
-    if ((y < height-1 && h == 1) || (y > 0 && h == -1)) {
-        int fall = rand() % 2;
-
-        if (fall == 0) {
-            if (move_left(p, map, x, y, h)) return true;
-            if (move_right(p, map, x, y, h)) return true;
-        }
-        else {
-            if (move_right(p, map, x, y, h)) return true;
-            if (move_left(p, map, x, y, h)) return true;
-        }
-    }
-    return false;
-}
-
-bool flow(Particle* p, Particle*** map, int x, int y) {
-
-    int xn; 
-    if (p->velocity == 1) {
-
-        xn = x;
-        for (int n=1; n<SPREAD[p->element]+1; n++) {
-
-            if (x-n >= 0 && map[x-n][y]->type < p->type) xn = x-n;
-            else break;
-        }
-    }
-    if (p->velocity == -1) {
-
-        xn = x;
-        for (int n=1; n<SPREAD[p->element]+1; n++) {
-
-            if (x+n < width && map[x+n][y]->type < p->type) xn = x+n;
-            else break;
-        }
-    }
-    if (xn == x) {
-        p->velocity *= -1;
-        return false;
-    }
-    else {
-        mix_elements(map, x, y, xn, y);
-        return true;
-    }
-}
-
-void sand_update(Particle* p, Particle*** map, int x, int y) {
-
-    if (!fall_down(p, map, x, y)) {
-
-        move_side(p, map, x, y, 1);
-    }
-}
-
-void dirt_update(Particle* p, Particle*** map, int x, int y) {
-
-    if (!fall_down(p, map, x, y)) {
-
-        move_side(p, map, x, y, 1);
-    }
-}
-
-void stone_update(Particle* p, Particle*** map, int x, int y) {
-
-    if (!fall_down(p, map, x, y)) {
-
-        move_side(p, map, x, y, 1);
-    }
-}
-
-void obsidian_update(Particle* p, Particle*** map, int x, int y) {
-    fall_down(p, map, x, y);
-}
-
-void steel_update(Particle* p, Particle*** map, int x, int y) {}
-
-void wood_update(Particle* p, Particle*** map, int x, int y) {}
-
-void water_update(Particle* p, Particle*** map, int x, int y) {
-
-    bool end = false;
-
-    if (x > 0) {
-        if (map[x-1][y]->element == PARTICLE_ACID) {
-            map[x-1][y]->element = PARTICLE_NONE;
-            map[x-1][y]->type = PARTICLE_VOID;
-            end = true;
-        }
-    }
-    if (x < width-1) {
-        if (map[x+1][y]->element == PARTICLE_ACID) {
-            map[x+1][y]->element = PARTICLE_NONE;
-            map[x+1][y]->type = PARTICLE_VOID;
-            end = true;
-        }
-    }
-    if (y < height-1) {
-        if (map[x][y+1]->element == PARTICLE_LAVA) {
-            map[x][y+1]->element = PARTICLE_OBSIDIAN;
-            map[x][y+1]->type = TYPES[PARTICLE_OBSIDIAN];
-            end = true;
-        }
-        else if (map[x][y+1]->element == PARTICLE_ACID) {
-            map[x][y+1]->element = PARTICLE_NONE;
-            map[x][y+1]->type = PARTICLE_VOID;
-            end = true;
-        }
-    }
-    if (end) {
-        p->element = PARTICLE_STEAM;
-        p->type = TYPES[PARTICLE_STEAM];
-        return;
-    }
-
-    if (fall_down(p, map, x, y)) return;
-    if (flow(p, map, x, y)) return;
-}
-
-void lava_update(Particle* p, Particle*** map, int x, int y) {
-
-    bool end = false;
-
-    if (x > 0) {
-        if (map[x-1][y]->element == PARTICLE_WATER || map[x-1][y]->element == PARTICLE_ACID) {
-            map[x-1][y]->element = PARTICLE_STEAM;
-            map[x-1][y]->type = TYPES[PARTICLE_STEAM];
-            end = true;
-        }
-        else if (map[x-1][y]->element == PARTICLE_WOOD) {
-            map[x-1][y]->element = PARTICLE_SMOKE;
-            map[x-1][y]->type = TYPES[PARTICLE_SMOKE];
-            if (rand() % 10 == 0) end = true;
-        }
-    }
-    if (x < width-1) {
-        if (map[x+1][y]->element == PARTICLE_WATER || map[x+1][y]->element == PARTICLE_ACID) {
-            map[x+1][y]->element = PARTICLE_STEAM;
-            map[x+1][y]->type = TYPES[PARTICLE_STEAM];
-            end = true;
-        }
-        else if (map[x+1][y]->element == PARTICLE_WOOD) {
-            map[x+1][y]->element = PARTICLE_SMOKE;
-            map[x+1][y]->type = TYPES[PARTICLE_SMOKE];
-            if (rand() % 10 == 0) end = true;
-        }
-    }
-    if (y < height-1) {
-        if (map[x][y+1]->element == PARTICLE_WATER || map[x][y+1]->element == PARTICLE_ACID) {
-            map[x][y+1]->element = PARTICLE_STEAM;
-            map[x][y+1]->type = TYPES[PARTICLE_STEAM];
-            end = true;
-        }
-        else if (map[x][y+1]->element == PARTICLE_WOOD) {
-            map[x][y+1]->element = PARTICLE_SMOKE;
-            map[x][y+1]->type = TYPES[PARTICLE_SMOKE];
-            if (rand() % 10 == 0) end = true;
-        }
-    }
-    if (end) {
-        p->element = PARTICLE_STONE;
-        p->type = TYPES[PARTICLE_STONE];
-        return;
-    }
-
-    if (fall_down(p, map, x, y)) return;
-    if (move_side(p, map, x, y, 1)) return;
-    if (flow(p, map, x, y)) return;
-
-
-}
-
-void acid_update(Particle* p, Particle*** map, int x, int y) {
-
-    bool end = false;
-
-    if (y < height-1) {
-        if (map[x][y+1]->element == PARTICLE_WATER) {
-            map[x-1][y]->element = PARTICLE_NONE;
-            map[x-1][y]->type = PARTICLE_VOID;
-            end = true;
-        }
-        else if (map[x][y+1]->element == PARTICLE_LAVA) {
-            map[x][y+1]->element = PARTICLE_OBSIDIAN;
-            map[x][y+1]->type = TYPES[PARTICLE_OBSIDIAN];
-            end = true;
-        }
-        else if (map[x][y+1]->element == PARTICLE_WOOD) {
-            map[x][y+1]->element = PARTICLE_NONE;
-            map[x][y+1]->type = PARTICLE_VOID;
-            if (rand() % 5 == 0) end = true;
-        }
-    }
-    if (end) {
-        p->element = PARTICLE_STEAM;
-        p->type = TYPES[PARTICLE_STEAM];
-        return;
-    }
-
-    if (fall_down(p, map, x, y)) return;
-    if (flow(p, map, x, y)) return;
-}
-
-void steam_update(Particle* p, Particle*** map, int x, int y) {
-
-    if (float_up(p, map, x, y)) return;
-    if (flow(p, map, x, y)) return;
-}
-
-void smoke_update(Particle* p, Particle*** map, int x, int y) {
-
-    if (float_up(p, map, x, y)) return;
-    if (move_side(p, map, x, y, -1)) return;
-    if (flow(p, map, x, y)) return;
-}
 
 // Constructs a SDL_Rect
 void new_rect(SDL_Rect* rect, int x, int y, int w, int h) {
@@ -413,9 +45,6 @@ void outline_rect(SDL_Rect* rect, SDL_Renderer* screen) {
 // Main function
 int main(int argc, char* argv[]) {
 
-    // Seeding random
-    srand(time(NULL));
-
     // SDL innit
     SDL_Init(SDL_INIT_EVERYTHING);
     SDL_Window* window = SDL_CreateWindow("Title", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
@@ -440,26 +69,29 @@ int main(int argc, char* argv[]) {
     unsigned int end_time = 0;
     unsigned int delta = 0;
     
-    // Particle map
-    Particle*** particles = malloc(sizeof(Particle**) * width);
-    for (int w=0; w < width; w++) {
-        particles[w] = malloc(sizeof(Particle*) * height);
-    }
-    for (int w=0; w < width; w++) {
-        for (int h=0; h < height; h++) {
-            particles[w][h] = malloc(sizeof(Particle));
-            new_particle(particles[w][h], PARTICLE_VOID, PARTICLE_NONE);
-        }
+    // Particle world
+    int width = SCREEN_WIDTH / PARTICLE_SIZE;
+    int height = SCREEN_HEIGHT / PARTICLE_SIZE;
+
+    Arena arena;
+    new_arena(&arena, world_size(width, height));
+    World* world = new_world(&arena, width, height);
+    if (world == NULL) {
+        fprintf(stderr, "Not enough memory for a %dx%d world\n", width, height);
+        free_arena(&arena);
+        SDL_Quit();
+        return 1;
     }
+    Particle*** particles = world->map;
+
+    // Seeding random
+    random_seed(world, time(NULL));
 
     // Particle data
     int particle_update_delay = 0;
     int particle_type = 0;
     int draw_size = 0;
 
-    // Different update functions for different types
-    function particle_update_functions[length] = {sand_update, dirt_update, stone_update, obsidian_update, steel_update, wood_update, water_update, lava_update, acid_update, steam_update, smoke_update};
-
     // Utility rects
     SDL_Rect particle_rect;
     SDL_Rect preview_rect;
@@ -547,7 +179,7 @@ int main(int argc, char* argv[]) {
                         int yj = y+j;
                         if (xi < 0 || xi >= width || yj < 0 || yj >= height) continue;
                         if (particles[xi][yj]->type == PARTICLE_VOID) {
-                            particles[xi][yj]->type = TYPES[particle_type];
+                            particles[xi][yj]->type = world->rules.types[particle_type];
                             particles[xi][yj]->element = particle_type;
                         }
                     }
@@ -582,17 +214,7 @@ int main(int argc, char* argv[]) {
         // Update particles every n frames
         if (particle_update_delay == PARTICLE_UPDATE_DELAY) {
 
-            for (int w=0; w < width; w++) {
-                for (int h=0; h < height; h++) {
-
-                    Particle* p = particles[w][h];
-
-                    if (p->type == PARTICLE_VOID || p->updated) continue;
-
-                    p->updated = true;
-                    particle_update_functions[p->element](p, particles, w, h);
-                }
-            }
+            update_world(world);
             particle_update_delay = 0;
         }
         else particle_update_delay++;
@@ -612,8 +234,6 @@ int main(int argc, char* argv[]) {
 
                 if (p->type == PARTICLE_VOID) continue;
 
-                p->updated = false;;
-
                 particle_rect.x = w * PARTICLE_SIZE;
                 particle_rect.y = h * PARTICLE_SIZE + MENU_HEIGHT;
 
@@ -689,15 +309,7 @@ int main(int argc, char* argv[]) {
     }
 
     // Deallocates particles
-    /*for (int w=0; w < width; w++) {
-        for (int h=0; w < height; h++) {
-            free(particles[w][h]);
-        }
-    }*/
-    for (int w=0; w < width; w++) {
-        free(particles[w]);
-    }
-    free(particles);
+    free_arena(&arena);
 
     SDL_Quit();
     return 0;
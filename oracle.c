@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "engine.h"
+#include "pool.h"
+
+
+// Engine struct, a named step function
+typedef struct {
+    const char* name;
+    step_function step;
+} Engine;
+
+// Steps like the reference, then turns the bottom left cell into steel
+void steel_corner_step(World* world) {
+
+    update_world(world);
+
+    Particle* p = world->map[0][world->height - 1];
+    p->type = world->rules.types[PARTICLE_STEEL];
+    p->element = PARTICLE_STEEL;
+}
+
+// Steps like the reference, then draws one extra random number
+void extra_draw_step(World* world) {
+
+    update_world(world);
+    random_next(world);
+}
+
+// Engines that can be checked, the first one is the reference
+// steel_corner and extra_draw are broken on purpose, diff and check have to fail on them
+const Engine ENGINES[] = {
+    {"scalar", update_world},
+    {"steel_corner", steel_corner_step},
+    {"extra_draw", extra_draw_step},
+};
+const int ENGINE_COUNT = sizeof(ENGINES) / sizeof(ENGINES[0]);
+
+// Default scene constants
+const int WORLD_WIDTH = 160;
+const int WORLD_HEIGHT = 120;
+const int DEFAULT_SEEDS = 8;
+const int DEFAULT_TICKS = 1000;
+const int DEFAULT_INTERVAL = 50;
+
+const Engine* find_engine(const char* name) {
+
+    for (int e=0; e < ENGINE_COUNT; e++) {
+        if (strcmp(ENGINES[e].name, name) == 0) return &ENGINES[e];
+    }
+    fprintf(stderr, "Unknown engine: %s\n", name);
+    return NULL;
+}
+
+bool same_particle(Particle* a, Particle* b) {
+
+    return a->type == b->type && a->element == b->element &&
+           a->velocity == b->velocity && a->gravity == b->gravity;
+}
+
+// Record struct, the scenes shared by all lanes
+typedef struct {
+    uint64_t* hashes;
+    int seeds;
+    int ticks;
+    int interval;
+    int samples;
+    atomic_int next;
+    atomic_int failed;
+} Record;
+
+// Takes seeds until none are left, every lane reuses one world
+void record_task(void* data, int lane) {
+
+    Record* record = data;
+
+    Arena arena;
+    new_arena(&arena, world_size(WORLD_WIDTH, WORLD_HEIGHT));
+    World* world = new_world(&arena, WORLD_WIDTH, WORLD_HEIGHT);
+    if (world == NULL) {
+        fprintf(stderr, "Lane %d: not enough memory for a world\n", lane);
+        atomic_fetch_add(&record->failed, 1);
+        free_arena(&arena);
+        return;
+    }
+
+    while (true) {
+
+        int index = atomic_fetch_add(&record->next, 1);
+        if (index >= record->seeds) break;
+
+        uint64_t* hashes = record->hashes + (size_t)index * record->samples;
+
+        seed_world(world, index + 1);
+
+        for (int tick=0; tick <= record->ticks; tick++) {
+
+            if (tick % record->interval == 0) hashes[tick / record->interval] = hash_world(world);
+            if (tick < record->ticks) update_world(world);
+        }
+    }
+
+    free_arena(&arena);
+}
+
+// Runs seeded scenes and writes the world hash every interval ticks
+int record(const char* path, int seeds, int ticks, int interval) {
+
+    Record data;
+    data.seeds = seeds;
+    data.ticks = ticks;
+    data.interval = interval;
+    data.samples = ticks / interval + 1;
+    atomic_init(&data.next, 0);
+    atomic_init(&data.failed, 0);
+
+    // Only the hashes grow with the seeds, worlds grow with the threads
+    data.hashes = malloc(sizeof(uint64_t) * seeds * data.samples);
+    if (data.hashes == NULL) {
+        fprintf(stderr, "Not enough memory for %d seeds of hashes\n", seeds);
+        return 1;
+    }
+
+    int lanes = core_count() < seeds ? core_count() : seeds;
+
+    Pool pool;
+    if (!new_pool(&pool, lanes)) {
+        fprintf(stderr, "Can't start %d threads\n", lanes);
+        free(data.hashes);
+        return 1;
+    }
+    pool_run(&pool, record_task, &data, lanes);
+    free_pool(&pool);
+
+    // A lane without a world leaves its share to the others, only all of them failing loses seeds
+    if (atomic_load(&data.failed) == lanes) {
+        free(data.hashes);
+        return 1;
+    }
+
+    FILE* trace = fopen(path, "w");
+    if (trace == NULL) {
+        fprintf(stderr, "Can't open trace: %s\n", path);
+        free(data.hashes);
+        return 1;
+    }
+
+    for (int seed=0; seed < seeds; seed++) {
+        for (int sample=0; sample < data.samples; sample++) {
+            fprintf(trace, "%d %d %016" PRIx64 "\n", seed + 1, sample * interval, data.hashes[(size_t)seed * data.samples + sample]);
+        }
+    }
+
+    free(data.hashes);
+    fclose(trace);
+    return 0;
+}
+
+// Trace line struct, the world hash of a seed at a tick
+typedef struct {
+    int seed;
+    int tick;
+    uint64_t hash;
+} TraceLine;
+
+// Reads every line of a trace, fails on an empty or malformed trace so it can't pass as a match
+int read_trace(const char* path, TraceLine** lines, int* count) {
+
+    FILE* trace = fopen(path, "r");
+    if (trace == NULL) {
+        fprintf(stderr, "Can't open trace: %s\n", path);
+        return 1;
+    }
+
+    int capacity = 256;
+    *lines = malloc(sizeof(TraceLine) * capacity);
+    *count = 0;
+
+    // Every line is "seed tick hash" with a 16 digit hash and a newline, so a cut off trace is caught
+    char text[128];
+    int result = 0;
+    while (*lines != NULL && fgets(text, sizeof(text), trace) != NULL) {
+
+        TraceLine line;
+        char hash[17];
+        int end = 0;
+        if (strchr(text, '\n') == NULL ||
+            sscanf(text, "%d %d %16[0-9a-f]%n", &line.seed, &line.tick, hash, &end) != 3 ||
+            strlen(hash) != 16 || text[end + strspn(text + end, " \t\r")] != '\n') {
+            printf("Malformed trace line after %d hashes, expected \"seed tick hash\"\n", *count);
+            result = 1;
+            break;
+        }
+        line.hash = strtoull(hash, NULL, 16);
+
+        if (*count == capacity) {
+            capacity *= 2;
+            TraceLine* grown = realloc(*lines, sizeof(TraceLine) * capacity);
+            if (grown == NULL) {
+                free(*lines);
+                *lines = NULL;
+                break;
+            }
+            *lines = grown;
+        }
+        (*lines)[(*count)++] = line;
+    }
+
+    if (*lines == NULL) {
+        fprintf(stderr, "Not enough memory for trace: %s\n", path);
+        result = 1;
+    }
+    else if (result == 0 && ferror(trace)) {
+        fprintf(stderr, "Can't read trace: %s\n", path);
+        result = 1;
+    }
+    else if (result == 0 && *count == 0) {
+        printf("Trace has no hashes\n");
+        result = 1;
+    }
+
+    if (result != 0) {
+        free(*lines);
+        *lines = NULL;
+    }
+    fclose(trace);
+    return result;
+}
+
+// Replays a trace with an engine and reports the first hash that differs
+int check(const char* path, const Engine* engine) {
+
+    TraceLine* lines;
+    int count;
+    if (read_trace(path, &lines, &count) != 0) return 1;
+
+    Arena arena;
+    new_arena(&arena, world_size(WORLD_WIDTH, WORLD_HEIGHT));
+    World* world = new_world(&arena, WORLD_WIDTH, WORLD_HEIGHT);
+    if (world == NULL) {
+        fprintf(stderr, "Not enough memory for a world\n");
+        free_arena(&arena);
+        free(lines);
+        return 1;
+    }
+
+    int seed = 0;
+    int tick = 0;
+    int result = 0;
+
+    for (int l=0; l < count; l++) {
+
+        // Restarts the scene for a new seed
+        if (lines[l].seed != seed || lines[l].tick < tick) {
+            seed = lines[l].seed;
+            tick = 0;
+            seed_world(world, seed);
+        }
+        for (; tick < lines[l].tick; tick++) engine->step(world);
+
+        uint64_t hash = hash_world(world);
+        if (hash != lines[l].hash) {
+            printf("Seed %d diverged at tick %d: expected %016" PRIx64 ", got %016" PRIx64 "\n", seed, tick, lines[l].hash, hash);
+            result = 1;
+            break;
+        }
+    }
+
+    if (result == 0) printf("%s matched %d hashes\n", engine->name, count);
+
+    free_arena(&arena);
+    free(lines);
+    return result;
+}
+
+// Replays every seed of a trace at once, the worlds are stepped together on the pool with update_worlds
+int parallel(const char* path) {
+
+    TraceLine* lines;
+    int count;
+    if (read_trace(path, &lines, &count) != 0) return 1;
+
+    // Every seed needs its lines together in tick order, firsts[s] to firsts[s + 1] are the lines of world s
+    int* firsts = malloc(sizeof(int) * (count + 1));
+    if (firsts == NULL) {
+        fprintf(stderr, "Not enough memory for trace: %s\n", path);
+        free(lines);
+        return 1;
+    }
+    int seeds = 0;
+    int last_tick = 0;
+    for (int l=0; l < count; l++) {
+
+        if (l == 0 || lines[l].seed != lines[l - 1].seed) {
+            for (int s=0; s < seeds; s++) {
+                if (lines[firsts[s]].seed == lines[l].seed) {
+                    printf("Seed %d is split across the trace\n", lines[l].seed);
+                    free(firsts);
+                    free(lines);
+                    return 1;
+                }
+            }
+            firsts[seeds++] = l;
+        }
+        else if (lines[l].tick <= lines[l - 1].tick) {
+            printf("Seed %d ticks are out of order\n", lines[l].seed);
+            free(firsts);
+            free(lines);
+            return 1;
+        }
+        if (lines[l].tick > last_tick) last_tick = lines[l].tick;
+    }
+    firsts[seeds] = count;
+
+    Arena arena;
+    new_arena(&arena, world_size(WORLD_WIDTH, WORLD_HEIGHT) * seeds);
+    World** worlds = malloc(sizeof(World*) * seeds);
+    int* nexts = malloc(sizeof(int) * seeds);
+
+    Pool pool;
+    bool ready = worlds != NULL && nexts != NULL;
+    if (!ready) fprintf(stderr, "Not enough memory for %d worlds\n", seeds);
+    else if (!new_pool(&pool, core_count())) {
+        fprintf(stderr, "Can't start %d threads\n", core_count());
+        ready = false;
+    }
+
+    for (int s=0; ready && s < seeds; s++) {
+        worlds[s] = new_world(&arena, WORLD_WIDTH, WORLD_HEIGHT);
+        if (worlds[s] == NULL) {
+            fprintf(stderr, "Not enough memory for %d worlds\n", seeds);
+            free_pool(&pool);
+            ready = false;
+            break;
+        }
+        seed_world(worlds[s], lines[firsts[s]].seed);
+        nexts[s] = firsts[s];
+    }
+    if (!ready) {
+        free(nexts);
+        free(worlds);
+        free_arena(&arena);
+        free(firsts);
+        free(lines);
+        return 1;
+    }
+
+    int result = 0;
+    for (int tick=0; tick <= last_tick && result == 0; tick++) {
+
+        for (int s=0; s < seeds; s++) {
+
+            if (nexts[s] == firsts[s + 1] || lines[nexts[s]].tick != tick) continue;
+
+            uint64_t hash = hash_world(worlds[s]);
+            if (hash != lines[nexts[s]].hash) {
+                printf("Seed %d diverged at tick %d: expected %016" PRIx64 ", got %016" PRIx64 "\n", lines[nexts[s]].seed, tick, lines[nexts[s]].hash, hash);
+                result = 1;
+                break;
+            }
+            nexts[s]++;
+        }
+        if (tick < last_tick) update_worlds(&pool, worlds, seeds);
+    }
+
+    if (result == 0) printf("%d worlds on the pool matched %d hashes\n", seeds, count);
+
+    free_pool(&pool);
+    free(nexts);
+    free(worlds);
+    free_arena(&arena);
+    free(firsts);
+    free(lines);
+    return result;
+}
+
+// Steps the reference and an engine side by side and reports the first cell that differs
+int diff(const Engine* engine, int seeds, int ticks) {
+
+    Arena arena;
+    new_arena(&arena, world_size(WORLD_WIDTH, WORLD_HEIGHT) * 2);
+    World* reference = new_world(&arena, WORLD_WIDTH, WORLD_HEIGHT);
+    World* world = new_world(&arena, WORLD_WIDTH, WORLD_HEIGHT);
+    if (reference == NULL || world == NULL) {
+        fprintf(stderr, "Not enough memory for two worlds\n");
+        free_arena(&arena);
+        return 1;
+    }
+
+    for (int seed=1; seed <= seeds; seed++) {
+
+        seed_world(reference, seed);
+        seed_world(world, seed);
+
+        for (int tick=1; tick <= ticks; tick++) {
+
+            ENGINES[0].step(reference);
+            engine->step(world);
+
+            for (int w=0; w < WORLD_WIDTH; w++) {
+                for (int h=0; h < WORLD_HEIGHT; h++) {
+
+                    Particle* r = reference->map[w][h];
+                    Particle* p = world->map[w][h];
+
+                    if (same_particle(r, p)) continue;
+
+                    printf("Seed %d diverged at tick %d, cell (%d, %d)\n", seed, tick, w, h);
+                    printf("  %s: type %d, element %d, velocity %d, gravity %.1f\n", ENGINES[0].name, r->type, r->element, r->velocity, r->gravity);
+                    printf("  %s: type %d, element %d, velocity %d, gravity %.1f\n", engine->name, p->type, p->element, p->velocity, p->gravity);
+
+                    free_arena(&arena);
+                    return 1;
+                }
+            }
+            if (world->random_state != reference->random_state) {
+                printf("Seed %d diverged at tick %d: %s used a different number of random draws\n", seed, tick, engine->name);
+
+                free_arena(&arena);
+                return 1;
+            }
+        }
+    }
+
+    printf("%s matched %s for %d seeds of %d ticks\n", engine->name, ENGINES[0].name, seeds, ticks);
+
+    free_arena(&arena);
+    return 0;
+}
+
+void usage(void) {
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "  oracle record <trace> [seeds] [ticks] [interval]\n");
+    fprintf(stderr, "  oracle check <trace> [engine]\n");
+    fprintf(stderr, "  oracle parallel <trace>\n");
+    fprintf(stderr, "  oracle diff <engine> [seeds] [ticks]\n");
+}
+
+// Main function
+int main(int argc, char* argv[]) {
+
+    if (argc < 3) {
+        usage();
+        return 2;
+    }
+
+    if (strcmp(argv[1], "record") == 0) {
+
+        int seeds = argc > 3 ? atoi(argv[3]) : DEFAULT_SEEDS;
+        int ticks = argc > 4 ? atoi(argv[4]) : DEFAULT_TICKS;
+        int interval = argc > 5 ? atoi(argv[5]) : DEFAULT_INTERVAL;
+        if (seeds < 1 || ticks < 0 || interval < 1) {
+            usage();
+            return 2;
+        }
+        return record(argv[2], seeds, ticks, interval);
+    }
+    else if (strcmp(argv[1], "check") == 0) {
+
+        const Engine* engine = argc > 3 ? find_engine(argv[3]) : &ENGINES[0];
+        if (engine == NULL) return 2;
+
+        return check(argv[2], engine);
+    }
+    else if (strcmp(argv[1], "parallel") == 0) {
+
+        return parallel(argv[2]);
+    }
+    else if (strcmp(argv[1], "diff") == 0) {
+
+        const Engine* engine = find_engine(argv[2]);
+        if (engine == NULL) return 2;
+
+        int seeds = argc > 3 ? atoi(argv[3]) : DEFAULT_SEEDS;
+        int ticks = argc > 4 ? atoi(argv[4]) : DEFAULT_TICKS;
+        if (seeds < 1 || ticks < 0) {
+            usage();
+            return 2;
+        }
+        return diff(engine, seeds, ticks);
+    }
+
+    usage();
+    return 2;
+}
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+
+int core_count(void) {
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cores > 0 ? (int)cores : 1;
+}
+
+// Takes tasks until the current run has none left, lock is held on entry and exit
+static void work(Pool* pool) {
+
+    while (pool->next < pool->count) {
+
+        int index = pool->next++;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool->task(pool->data, index);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->finished++;
+        if (pool->finished == pool->count) pthread_cond_signal(&pool->done);
+    }
+}
+
+static void* worker(void* data) {
+
+    Pool* pool = data;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+
+        while (!pool->stopping && pool->next >= pool->count) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->stopping) break;
+
+        work(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+bool new_pool(Pool* pool, int threads) {
+
+    if (threads < 1) threads = 1;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->task = NULL;
+    pool->data = NULL;
+    pool->count = 0;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->stopping = false;
+
+    pool->thread_count = 0;
+    pool->threads = malloc(sizeof(pthread_t) * threads);
+    if (pool->threads == NULL) {
+        free_pool(pool);
+        return false;
+    }
+
+    for (int t=0; t < threads - 1; t++) {
+
+        // Stops the threads that did start, a pool never runs short handed
+        if (pthread_create(&pool->threads[t], NULL, worker, pool) != 0) {
+            free_pool(pool);
+            return false;
+        }
+        pool->thread_count++;
+    }
+    return true;
+}
+
+void pool_run(Pool* pool, task_function task, void* data, int count) {
+
+    pthread_mutex_lock(&pool->lock);
+
+    pool->task = task;
+    pool->data = data;
+    pool->count = count;
+    pool->next = 0;
+    pool->finished = 0;
+    pthread_cond_broadcast(&pool->wake);
+
+    work(pool);
+    while (pool->finished < pool->count) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void update_task(void* data, int index) {
+
+    World** worlds = data;
+
+    update_world(worlds[index]);
+}
+
+void update_worlds(Pool* pool, World** worlds, int count) {
+    pool_run(pool, update_task, worlds, count);
+}
+
+void free_pool(Pool* pool) {
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int t=0; t < pool->thread_count; t++) {
+        pthread_join(pool->threads[t], NULL);
+    }
+    free(pool->threads);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+}
@@ -0,0 +1,43 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "engine.h"
+
+
+// Task variables type, gets the shared data and the task index
+typedef void (*task_function)(void*, int);
+
+// Pool struct, worker threads that share the tasks of one run
+typedef struct {
+    pthread_t* threads;
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    task_function task;
+    void* data;
+    int count;
+    int next;
+    int finished;
+    bool stopping;
+} Pool;
+
+// Returns the number of online cores
+int core_count(void);
+
+// Starts the worker threads, the calling thread also works so threads - 1 are created
+// Returns false and leaves nothing running if any of them couldn't be started
+bool new_pool(Pool* pool, int threads);
+
+// Runs task 0 to count - 1 across the pool and waits until all are finished
+void pool_run(Pool* pool, task_function task, void* data, int count);
+
+// Updates every world once, one task per world
+void update_worlds(Pool* pool, World** worlds, int count);
+
+// Stops and joins the worker threads
+void free_pool(Pool* pool);
+
+#endif
@@ -0,0 +1,477 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include "engine.h"
+#include "pool.h"
+
+
+#define MAX_PARAMETERS 32
+#define MAX_VALUES 64
+
+
+// Element names used in the specification and the results header
+const char* NAMES[length] = {"sand", "dirt", "stone", "obsidian", "steel", "wood", "water", "lava", "acid", "steam", "smoke"};
+
+// Parameter kinds
+const int PARAMETER_WIDTH = 0;
+const int PARAMETER_HEIGHT = 1;
+const int PARAMETER_TYPE = 2;
+const int PARAMETER_SPREAD = 3;
+const int PARAMETER_LAVA_BURN = 4;
+const int PARAMETER_ACID_BURN = 5;
+
+// Default sweep constants
+const int DEFAULT_WIDTH = 160;
+const int DEFAULT_HEIGHT = 120;
+const int DEFAULT_TICKS = 1000;
+const int DEFAULT_SETTLE = 50;
+const long MAX_RUNS = 1000000;
+
+// Parameter struct, one swept value list
+typedef struct {
+    int kind;
+    int element;
+    int line;
+    int count;
+    int values[MAX_VALUES];
+} Parameter;
+
+// Sweep struct, the parsed specification
+typedef struct {
+    int ticks;
+    int settle;
+    int first_seed;
+    int last_seed;
+    int parameter_count;
+    Parameter parameters[MAX_PARAMETERS];
+} Sweep;
+
+// Run struct, one variant and its metrics
+typedef struct {
+    int seed;
+    int width;
+    int height;
+    Rules rules;
+    int choices[MAX_PARAMETERS];
+    double seconds;
+    int settle_tick;
+    int last_reaction_tick;
+    int population[length + 1];  // Last one counts void cells
+    bool failed;
+} Run;
+
+// Batch struct, the runs shared by all lanes
+typedef struct {
+    Run* runs;
+    int run_count;
+    int ticks;
+    int settle;
+    atomic_int next;
+    atomic_int failed;
+} Batch;
+
+int parse_element(const char* token) {
+
+    for (int e=0; e < length; e++) {
+        if (strcmp(NAMES[e], token) == 0) return e;
+    }
+
+    char* end;
+    long element = strtol(token, &end, 10);
+    if (*end == '\0' && element >= 0 && element < length) return (int)element;
+
+    return -1;
+}
+
+bool parse_int(const char* token, int* value) {
+
+    char* end;
+    long number = strtol(token, &end, 10);
+    if (*token == '\0' || *end != '\0' || number < INT_MIN || number > INT_MAX) return false;
+
+    *value = (int)number;
+    return true;
+}
+
+// Smallest value each parameter accepts
+int minimum_value(int kind) {
+
+    if (kind == PARAMETER_TYPE) return PARTICLE_GAS;
+    if (kind == PARAMETER_SPREAD) return 0;
+    return 1;
+}
+
+// Largest value each parameter accepts, a spread past the widest map only wastes ticks
+int maximum_value(int kind, int max_width) {
+
+    if (kind == PARAMETER_TYPE) return PARTICLE_SOLID;
+    if (kind == PARAMETER_SPREAD) return max_width;
+    return INT_MAX;
+}
+
+// Reads the sweep specification, one setting per line, # starts a comment
+int parse_sweep(const char* path, Sweep* sweep) {
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Can't open sweep: %s\n", path);
+        return 1;
+    }
+
+    sweep->ticks = DEFAULT_TICKS;
+    sweep->settle = DEFAULT_SETTLE;
+    sweep->first_seed = 1;
+    sweep->last_seed = 1;
+    sweep->parameter_count = 0;
+
+    char line[1024];
+    int number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        number++;
+
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char* key = strtok(line, " \t\r\n");
+        if (key == NULL) continue;
+
+        char* tokens[MAX_VALUES + 1];
+        int token_count = 0;
+        char* token;
+        while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+            if (token_count == MAX_VALUES + 1) {
+                fprintf(stderr, "%s:%d: too many values\n", path, number);
+                fclose(file);
+                return 1;
+            }
+            tokens[token_count++] = token;
+        }
+
+        if (strcmp(key, "ticks") == 0) {
+            if (token_count != 1 || !parse_int(tokens[0], &sweep->ticks) || sweep->ticks < 1) {
+                fprintf(stderr, "%s:%d: expected ticks <count>\n", path, number);
+                fclose(file);
+                return 1;
+            }
+            continue;
+        }
+        if (strcmp(key, "settle") == 0) {
+            if (token_count != 1 || !parse_int(tokens[0], &sweep->settle) || sweep->settle < 0) {
+                fprintf(stderr, "%s:%d: expected settle <changes>\n", path, number);
+                fclose(file);
+                return 1;
+            }
+            continue;
+        }
+        if (strcmp(key, "seeds") == 0) {
+            // Seed 0 would repeat seed 1, the random generator can't start from 0
+            if (token_count != 2 || !parse_int(tokens[0], &sweep->first_seed) || !parse_int(tokens[1], &sweep->last_seed) ||
+                sweep->first_seed < 1 || sweep->first_seed > sweep->last_seed) {
+                fprintf(stderr, "%s:%d: expected seeds <first> <last>, starting from 1\n", path, number);
+                fclose(file);
+                return 1;
+            }
+            continue;
+        }
+
+        if (sweep->parameter_count == MAX_PARAMETERS) {
+            fprintf(stderr, "%s:%d: too many parameters\n", path, number);
+            fclose(file);
+            return 1;
+        }
+        Parameter* parameter = &sweep->parameters[sweep->parameter_count];
+        parameter->element = PARTICLE_NONE;
+        parameter->line = number;
+
+        int first = 0;
+        if (strcmp(key, "width") == 0) parameter->kind = PARAMETER_WIDTH;
+        else if (strcmp(key, "height") == 0) parameter->kind = PARAMETER_HEIGHT;
+        else if (strcmp(key, "lava_burn") == 0) parameter->kind = PARAMETER_LAVA_BURN;
+        else if (strcmp(key, "acid_burn") == 0) parameter->kind = PARAMETER_ACID_BURN;
+        else if (strcmp(key, "type") == 0 || strcmp(key, "spread") == 0) {
+
+            parameter->kind = strcmp(key, "type") == 0 ? PARAMETER_TYPE : PARAMETER_SPREAD;
+            parameter->element = token_count > 0 ? parse_element(tokens[0]) : -1;
+            if (parameter->element < 0) {
+                fprintf(stderr, "%s:%d: expected %s <element> <values>\n", path, number, key);
+                fclose(file);
+                return 1;
+            }
+            first = 1;
+        }
+        else {
+            fprintf(stderr, "%s:%d: unknown setting: %s\n", path, number, key);
+            fclose(file);
+            return 1;
+        }
+
+        parameter->count = token_count - first;
+        if (parameter->count < 1 || parameter->count > MAX_VALUES) {
+            fprintf(stderr, "%s:%d: expected 1 to %d values\n", path, number, MAX_VALUES);
+            fclose(file);
+            return 1;
+        }
+        for (int v=0; v < parameter->count; v++) {
+            if (!parse_int(tokens[first + v], &parameter->values[v]) || parameter->values[v] < minimum_value(parameter->kind)) {
+                fprintf(stderr, "%s:%d: invalid value: %s\n", path, number, tokens[first + v]);
+                fclose(file);
+                return 1;
+            }
+        }
+        sweep->parameter_count++;
+    }
+    fclose(file);
+
+    // Upper bounds are checked once every width is known
+    int max_width = DEFAULT_WIDTH;
+    for (int p=0; p < sweep->parameter_count; p++) {
+
+        Parameter* parameter = &sweep->parameters[p];
+        if (parameter->kind != PARAMETER_WIDTH) continue;
+
+        max_width = 0;
+        for (int v=0; v < parameter->count; v++) {
+            if (parameter->values[v] > max_width) max_width = parameter->values[v];
+        }
+    }
+    for (int p=0; p < sweep->parameter_count; p++) {
+
+        Parameter* parameter = &sweep->parameters[p];
+        int maximum = maximum_value(parameter->kind, max_width);
+
+        for (int v=0; v < parameter->count; v++) {
+            if (parameter->values[v] > maximum) {
+                fprintf(stderr, "%s:%d: invalid value: %d, at most %d\n", path, parameter->line, parameter->values[v], maximum);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Builds run index, seeds change fastest then the parameters in file order
+void new_run(Run* run, Sweep* sweep, int index) {
+
+    int seeds = sweep->last_seed - sweep->first_seed + 1;
+
+    run->seed = sweep->first_seed + index % seeds;
+    run->width = DEFAULT_WIDTH;
+    run->height = DEFAULT_HEIGHT;
+    run->rules = DEFAULT_RULES;
+    run->seconds = 0;
+    run->settle_tick = -1;
+    run->last_reaction_tick = 0;
+    run->failed = false;
+    for (int e=0; e <= length; e++) run->population[e] = 0;
+
+    index /= seeds;
+    for (int p=0; p < sweep->parameter_count; p++) {
+
+        Parameter* parameter = &sweep->parameters[p];
+        int choice = index % parameter->count;
+        int value = parameter->values[choice];
+        index /= parameter->count;
+
+        run->choices[p] = choice;
+
+        if (parameter->kind == PARAMETER_WIDTH) run->width = value;
+        else if (parameter->kind == PARAMETER_HEIGHT) run->height = value;
+        else if (parameter->kind == PARAMETER_TYPE) run->rules.types[parameter->element] = value;
+        else if (parameter->kind == PARAMETER_SPREAD) run->rules.spread[parameter->element] = value;
+        else if (parameter->kind == PARAMETER_LAVA_BURN) run->rules.lava_burn = value;
+        else if (parameter->kind == PARAMETER_ACID_BURN) run->rules.acid_burn = value;
+    }
+}
+
+double seconds_since(struct timespec* start) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Counts the cells of every element, last one counts void cells
+void count_population(World* world, int* population) {
+
+    for (int e=0; e <= length; e++) population[e] = 0;
+    for (int w=0; w < world->width; w++) {
+        for (int h=0; h < world->height; h++) {
+
+            int element = world->map[w][h]->element;
+            population[element == PARTICLE_NONE ? length : element]++;
+        }
+    }
+}
+
+// Steps the world and records its metrics, only update_world is timed
+void simulate(World* world, Run* run, int ticks, int settle) {
+
+    // Liquids keep bouncing between walls, so the world has settled once moves and reactions stay at or below settle
+    int last_busy = 0;
+
+    for (int tick=1; tick <= ticks; tick++) {
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        update_world(world);
+        run->seconds += seconds_since(&start);
+
+        if (world->moves + world->reactions > settle) last_busy = tick;
+        if (world->reactions > 0) run->last_reaction_tick = tick;
+    }
+    run->settle_tick = last_busy < ticks ? last_busy : -1;
+
+    count_population(world, run->population);
+}
+
+// Takes runs until none are left, every lane reuses one arena and only grows it when a run needs more
+void lane_task(void* data, int lane) {
+
+    Batch* batch = data;
+
+    Arena arena;
+    new_arena(&arena, 0);
+
+    while (true) {
+
+        int index = atomic_fetch_add(&batch->next, 1);
+        if (index >= batch->run_count) break;
+
+        Run* run = &batch->runs[index];
+
+        size_t size = world_size(run->width, run->height);
+        if (size > arena.size) {
+            free_arena(&arena);
+            new_arena(&arena, size);
+        }
+
+        arena_reset(&arena);
+        World* world = new_world(&arena, run->width, run->height);
+        if (world == NULL) {
+            fprintf(stderr, "Lane %d: not enough memory for run %d (%dx%d)\n", lane, index, run->width, run->height);
+            run->failed = true;
+            atomic_fetch_add(&batch->failed, 1);
+            continue;
+        }
+        world->rules = run->rules;
+        seed_world(world, run->seed);
+
+        simulate(world, run, batch->ticks, batch->settle);
+    }
+
+    free_arena(&arena);
+}
+
+void write_results(FILE* results, Sweep* sweep, Batch* batch) {
+
+    fprintf(results, "run,status,seed,width,height");
+    for (int p=0; p < sweep->parameter_count; p++) {
+
+        Parameter* parameter = &sweep->parameters[p];
+
+        if (parameter->kind == PARAMETER_TYPE) fprintf(results, ",type_%s", NAMES[parameter->element]);
+        else if (parameter->kind == PARAMETER_SPREAD) fprintf(results, ",spread_%s", NAMES[parameter->element]);
+        else if (parameter->kind == PARAMETER_LAVA_BURN) fprintf(results, ",lava_burn");
+        else if (parameter->kind == PARAMETER_ACID_BURN) fprintf(results, ",acid_burn");
+    }
+    fprintf(results, ",ticks,seconds,ticks_per_second,settle_tick,last_reaction_tick");
+    for (int e=0; e < length; e++) fprintf(results, ",%s", NAMES[e]);
+    fprintf(results, ",void\n");
+
+    for (int r=0; r < batch->run_count; r++) {
+
+        Run* run = &batch->runs[r];
+
+        fprintf(results, "%d,%s,%d,%d,%d", r, run->failed ? "failed" : "ok", run->seed, run->width, run->height);
+        for (int p=0; p < sweep->parameter_count; p++) {
+
+            Parameter* parameter = &sweep->parameters[p];
+
+            if (parameter->kind == PARAMETER_WIDTH || parameter->kind == PARAMETER_HEIGHT) continue;
+            fprintf(results, ",%d", parameter->values[run->choices[p]]);
+        }
+        fprintf(results, ",%d,%.6f,%.1f,%d,%d", batch->ticks, run->seconds, run->seconds > 0 ? batch->ticks / run->seconds : 0, run->settle_tick, run->last_reaction_tick);
+        for (int e=0; e <= length; e++) fprintf(results, ",%d", run->population[e]);
+        fprintf(results, "\n");
+    }
+}
+
+// Main function
+int main(int argc, char* argv[]) {
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: sweep <specification> <results.csv> [threads]\n");
+        return 2;
+    }
+
+    Sweep sweep;
+    if (parse_sweep(argv[1], &sweep) != 0) return 1;
+
+    int threads = argc > 3 ? atoi(argv[3]) : core_count();
+    if (threads < 1) threads = 1;
+
+    // Every combination of values runs once per seed
+    long run_count = (long)sweep.last_seed - sweep.first_seed + 1;
+    for (int p=0; p < sweep.parameter_count && run_count <= MAX_RUNS; p++) {
+        run_count *= sweep.parameters[p].count;
+    }
+    if (run_count > MAX_RUNS) {
+        fprintf(stderr, "Sweep has more than %ld runs\n", MAX_RUNS);
+        return 1;
+    }
+
+    Batch batch;
+    batch.run_count = (int)run_count;
+    batch.ticks = sweep.ticks;
+    batch.settle = sweep.settle;
+    batch.runs = malloc(sizeof(Run) * batch.run_count);
+    if (batch.runs == NULL) {
+        fprintf(stderr, "Not enough memory for %d runs\n", batch.run_count);
+        return 1;
+    }
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.failed, 0);
+
+    for (int r=0; r < batch.run_count; r++) new_run(&batch.runs[r], &sweep, r);
+
+    FILE* results = fopen(argv[2], "w");
+    if (results == NULL) {
+        fprintf(stderr, "Can't open results: %s\n", argv[2]);
+        free(batch.runs);
+        return 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int lanes = threads < batch.run_count ? threads : batch.run_count;
+
+    Pool pool;
+    if (!new_pool(&pool, lanes)) {
+        fprintf(stderr, "Can't start %d threads\n", lanes);
+        fclose(results);
+        free(batch.runs);
+        return 1;
+    }
+    pool_run(&pool, lane_task, &batch, lanes);
+    free_pool(&pool);
+
+    double seconds = seconds_since(&start);
+    printf("%d runs of %d ticks on %d threads in %.2f s (%.1f runs/s)\n", batch.run_count, batch.ticks, lanes, seconds, batch.run_count / seconds);
+
+    write_results(results, &sweep, &batch);
+
+    int failed = atomic_load(&batch.failed);
+    if (failed > 0) fprintf(stderr, "%d runs failed, marked in %s\n", failed, argv[2]);
+
+    fclose(results);
+    free(batch.runs);
+    return failed > 0 ? 1 : 0;
+}